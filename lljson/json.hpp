@@ -39,15 +39,725 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <memory>
+#include <unordered_map>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdexcept>
+#include <math.h>
 #include <algorithm>
 #include <regex>
 #include <exception>
 #include <assert.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+    #include <emmintrin.h>
+    #define JSON_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define JSON_NEON
+#endif
+
+
+// ---------------------------------------------------------------------------
+// Length of leading run of plain text - ASCII without backslash escapes - which
+// can be copied as is. Checks 16 bytes per step with SSE2 or NEON, 8 bytes per
+// step elsewhere, exact position is found by the byte loop at the end.
+inline size_t JsonPlainPrefix(const char* ptr, size_t len) {
+    size_t idx = 0;
+#if defined(JSON_SSE2)
+    const __m128i slash = _mm_set1_epi8('\\');
+    for (; idx + 16 <= len; idx += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(ptr + idx));
+        if (_mm_movemask_epi8(_mm_or_si128(chunk, _mm_cmpeq_epi8(chunk, slash))) != 0)
+            break;
+    }
+#elif defined(JSON_NEON)
+    const uint8x16_t slash = vdupq_n_u8('\\');
+    const uint8x16_t high = vdupq_n_u8(0x80);
+    for (; idx + 16 <= len; idx += 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t*)(ptr + idx));
+        if (vmaxvq_u8(vorrq_u8(vcgeq_u8(chunk, high), vceqq_u8(chunk, slash))) != 0)
+            break;
+    }
+#else
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    for (; idx + 8 <= len; idx += 8) {
+        uint64_t word;
+        memcpy(&word, ptr + idx, sizeof(word));
+        uint64_t slashes = word ^ (ones * '\\');
+        if (((word & highs) | ((slashes - ones) & ~slashes & highs)) != 0)
+            break;
+    }
+#endif
+    while (idx < len && (unsigned char)ptr[idx] < 0x80 && ptr[idx] != '\\')
+        idx++;
+    return idx;
+}
+
+// Append code point as UTF-8.
+inline void JsonAppendUtf8(uint32_t code, string& out) {
+    if (code < 0x80) {
+        out += char(code);
+    } else if (code < 0x800) {
+        out += char(0xC0 | (code >> 6));
+        out += char(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += char(0xE0 | (code >> 12));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    } else {
+        out += char(0xF0 | (code >> 18));
+        out += char(0x80 | ((code >> 12) & 0x3F));
+        out += char(0x80 | ((code >> 6) & 0x3F));
+        out += char(0x80 | (code & 0x3F));
+    }
+}
+
+// Parse 4 hex digits of \uXXXX, return false if not hex.
+inline bool JsonHex4(const char* ptr, const char* end, uint32_t& code) {
+    if (end - ptr < 4)
+        return false;
+    code = 0;
+    for (int idx = 0; idx < 4; idx++) {
+        char chr = ptr[idx];
+        code <<= 4;
+        if (chr >= '0' && chr <= '9')
+            code |= chr - '0';
+        else if (chr >= 'a' && chr <= 'f')
+            code |= chr - 'a' + 10;
+        else if (chr >= 'A' && chr <= 'F')
+            code |= chr - 'A' + 10;
+        else
+            return false;
+    }
+    return true;
+}
+
+// Length of valid UTF-8 sequence starting at ptr (lead byte >= 0x80), 0 if invalid.
+// Rejects overlong forms, surrogates and code points above U+10FFFF.
+inline size_t JsonUtf8Length(const unsigned char* ptr, const unsigned char* end) {
+    unsigned char lead = ptr[0];
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xBF;     // Allowed range of second byte
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        len = 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        len = 3;
+        if (lead == 0xE0) lo = 0xA0;
+        if (lead == 0xED) hi = 0x9F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        len = 4;
+        if (lead == 0xF0) lo = 0x90;
+        if (lead == 0xF4) hi = 0x8F;
+    } else {
+        return 0;
+    }
+    if (size_t(end - ptr) < len || ptr[1] < lo || ptr[1] > hi)
+        return 0;
+    for (size_t idx = 2; idx < len; idx++) {
+        if ((ptr[idx] & 0xC0) != 0x80)
+            return 0;
+    }
+    return len;
+}
+
+// ---------------------------------------------------------------------------
+// Decode json string body (without quotes) into out in one pass. Escapes are
+// decoded, including \uXXXX surrogate pairs, and UTF-8 is validated. Invalid
+// sequences are replaced with U+FFFD. Plain runs are bulk copied.
+// Return false if anything invalid was replaced.
+inline bool JsonDecodeString(const char* ptr, size_t len, string& out) {
+    static const uint32_t REPLACEMENT = 0xFFFD;
+    const char* end = ptr + len;
+    bool valid = true;
+    out.reserve(out.length() + len);
+
+    while (ptr < end) {
+        size_t plainLen = JsonPlainPrefix(ptr, end - ptr);
+        out.append(ptr, plainLen);
+        ptr += plainLen;
+        if (ptr == end)
+            break;
+
+        if (*ptr != '\\') {
+            size_t utf8Len = JsonUtf8Length((const unsigned char*)ptr, (const unsigned char*)end);
+            if (utf8Len == 0) {
+                JsonAppendUtf8(REPLACEMENT, out);
+                valid = false;
+                ptr++;
+            } else {
+                out.append(ptr, utf8Len);
+                ptr += utf8Len;
+            }
+            continue;
+        }
+
+        if (ptr + 1 == end) {
+            JsonAppendUtf8(REPLACEMENT, out);
+            return false;
+        }
+        char esc = ptr[1];
+        ptr += 2;
+        switch (esc) {
+        case '"':  out += '"';  break;
+        case '\\': out += '\\'; break;
+        case '/':  out += '/';  break;
+        case 'b':  out += '\b'; break;
+        case 'f':  out += '\f'; break;
+        case 'n':  out += '\n'; break;
+        case 'r':  out += '\r'; break;
+        case 't':  out += '\t'; break;
+        case 'u': {
+            uint32_t code;
+            if (! JsonHex4(ptr, end, code)) {
+                JsonAppendUtf8(REPLACEMENT, out);
+                valid = false;
+                break;
+            }
+            ptr += 4;
+            if (code >= 0xD800 && code <= 0xDBFF) {
+                uint32_t low;
+                if (end - ptr >= 6 && ptr[0] == '\\' && ptr[1] == 'u'
+                    && JsonHex4(ptr + 2, end, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    ptr += 6;
+                } else {
+                    code = REPLACEMENT;     // Lone high surrogate
+                    valid = false;
+                }
+            } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                code = REPLACEMENT;         // Lone low surrogate
+                valid = false;
+            }
+            JsonAppendUtf8(code, out);
+        }
+        break;
+        default:
+            // Unknown escape, keep as written.
+            out += '\\';
+            out += esc;
+            valid = false;
+            break;
+        }
+    }
+    return valid;
+}
+
+// ---------------------------------------------------------------------------
+// Append text escaped for output inside a json string.
+inline void JsonEscapeString(const char* ptr, size_t len, string& out) {
+    static const char hex[] = "0123456789abcdef";
+    const char* end = ptr + len;
+    while (ptr < end) {
+        const char* runPtr = ptr;
+        while (ptr < end && (unsigned char)*ptr >= 0x20 && *ptr != '"' && *ptr != '\\')
+            ptr++;
+        out.append(runPtr, ptr - runPtr);
+        if (ptr == end)
+            break;
+
+        char chr = *ptr++;
+        switch (chr) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            out += "\\u00";
+            out += hex[(chr >> 4) & 0xF];
+            out += hex[chr & 0xF];
+            break;
+        }
+    }
+}
 
 
 typedef std::vector<lstring> StringList;
-typedef std::map<string, StringList> MapList;
+
+class JsonColumn;
+
+// Memory budget shared by all columns (-mem-limit), limit 0 is unlimited.
+// While a limit is set columns register here so the largest can be spilled.
+struct ColumnBudget {
+    size_t limit = 0;
+    size_t used = 0;
+    std::set<JsonColumn*> columns;
+};
+static ColumnBudget columnBudget;
+
+// One temporary file shared by all spilled columns, each column keeps the offset
+// of its own chunks so spilling uses a single file descriptor. Space is reused
+// once no spilled column is left.
+class ColumnSpillFile {
+public:
+    ~ColumnSpillFile() {
+        if (file != nullptr)
+            fclose(file);
+    }
+
+    // Append data, return its offset.
+    uint64_t append(const string& data) {
+        if (file == nullptr) {
+            file = tmpfile();
+            if (file == nullptr)
+                throw std::runtime_error(string(strerror(errno)) + ", Unable to create column spill file");
+        }
+        if (! seek(end) || fwrite(data.data(), 1, data.length(), file) != data.length())
+            throw std::runtime_error(string(strerror(errno)) + ", Unable to write column spill file");
+        uint64_t offset = end;
+        end += data.length();
+        return offset;
+    }
+    void read(uint64_t offset, size_t length, string& data) {
+        data.resize(length);
+        if (file == nullptr || fflush(file) != 0 || ! seek(offset)
+            || (length != 0 && fread(&data[0], 1, length, file) != length))
+            throw std::runtime_error("Unable to read column spill file");
+    }
+
+    void addUser() {
+        users++;
+    }
+    void removeUser() {
+        if (--users == 0)
+            end = 0;
+    }
+
+private:
+    FILE* file = nullptr;
+    uint64_t end = 0;
+    size_t users = 0;       // Spilled columns still referring to file
+
+    bool seek(uint64_t offset) {
+#ifdef _WIN32
+        return _fseeki64(file, int64_t(offset), SEEK_SET) == 0;
+#else
+        return fseeko(file, off_t(offset), SEEK_SET) == 0;
+#endif
+    }
+};
+static ColumnSpillFile columnSpill;
+
+// Values kept per column (-maxrows), 0 is unlimited.
+static size_t columnMaxRows = 0;
+
+// Columns only gather statistics (-summary), values are not stored.
+static bool columnSummary = false;
+
+// Arrays expand record aligned (-records), see RecordFill.
+static bool columnRecords = false;
+
+// 64-bit FNV-1a with a final avalanche mix, same result on all platforms.
+inline uint64_t JsonHash(const char* ptr, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t idx = 0; idx < len; idx++) {
+        hash = (hash ^ (unsigned char)ptr[idx]) * 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Order dependent combine of two hashes.
+inline uint64_t JsonHashCombine(uint64_t seed, uint64_t hash) {
+    return seed ^ (hash + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+// Streaming column statistics in constant memory. Distinct count is approximate,
+// HyperLogLog with 1024 one byte registers (about 3% error).
+class ColumnStats {
+public:
+    size_t count = 0;       // All values
+    size_t empty = 0;       // Empty cells
+    size_t numeric = 0;     // Unquoted values which parse as numbers
+    double minValue = 0;
+    double maxValue = 0;
+    double sum = 0;
+
+    void add(const string& value) {
+        count++;
+        if (value.empty()) {
+            empty++;
+            return;
+        }
+        addHash(JsonHash(value.data(), value.length()));
+
+        if (value[0] != '"') {
+            char* endPtr;
+            double number = strtod(value.c_str(), &endPtr);
+            if (*endPtr == '\0' && endPtr != value.c_str()) {
+                minValue = (numeric == 0) ? number : std::min(minValue, number);
+                maxValue = (numeric == 0) ? number : std::max(maxValue, number);
+                sum += number;
+                numeric++;
+            }
+        }
+    }
+
+    double mean() const {
+        return (numeric == 0) ? 0 : sum / numeric;
+    }
+
+    size_t distinct() const {
+        if (registers.empty())
+            return 0;
+        double invSum = 0;
+        size_t zeros = 0;
+        for (uint8_t reg : registers) {
+            invSum += 1.0 / double(uint64_t(1) << reg);
+            zeros += (reg == 0);
+        }
+        const double m = REGISTERS;
+        double estimate = (0.7213 / (1 + 1.079 / m)) * m * m / invSum;
+        if (estimate <= 2.5 * m && zeros != 0) {
+            estimate = m * log(m / zeros);   // Small range correction
+        }
+        return size_t(estimate + 0.5);
+    }
+
+private:
+    static const int INDEX_BITS = 10;
+    static const size_t REGISTERS = size_t(1) << INDEX_BITS;
+    std::vector<uint8_t> registers;
+
+    void addHash(uint64_t hash) {
+        if (registers.empty())
+            registers.resize(REGISTERS);
+        size_t idx = size_t(hash >> (64 - INDEX_BITS));
+        uint64_t rest = hash << INDEX_BITS;
+        uint8_t rank = 1;
+        while (rank <= 64 - INDEX_BITS && (rest & (uint64_t(1) << 63)) == 0) {
+            rank++;
+            rest <<= 1;
+        }
+        registers[idx] = std::max(registers[idx], rank);
+    }
+};
+
+// Column of transposed values. Repeated values (dayOfWeek, iconCode, phrases) are
+// interned into a per column dictionary and stored as small integer codes. Once the
+// column has too many distinct values it falls back to plain string storage.
+// If columnBudget is exceeded the largest columns spill their values to the shared
+// columnSpill file, use JsonColumn::Reader to read rows back in order.
+class JsonColumn {
+public:
+    typedef uint16_t Code;
+    static const size_t MAX_DICT = 4096;    // Fallback when more distinct values
+    static const size_t MIN_ROWS = 256;     // Rows before cardinality ratio is checked
+    static const size_t SPILL_CHUNK = 64 * 1024;    // Pending bytes written as one chunk
+
+    JsonColumn() {
+        if (columnBudget.limit != 0)
+            columnBudget.columns.insert(this);
+    }
+    JsonColumn(const JsonColumn&) = delete;
+    JsonColumn& operator=(const JsonColumn&) = delete;
+    ~JsonColumn() {
+        setBytes(0);
+        columnBudget.columns.erase(this);
+        if (spilled)
+            columnSpill.removeUser();
+    }
+
+    void push_back(const string& value) {
+        if (columnMaxRows != 0 && size() >= columnMaxRows)
+            return;
+        if (columnSummary) {
+            stats.add(value);
+            return;
+        }
+        if (spilled) {
+            writeSpill(value);
+            spillRows++;
+        } else if (! encoded) {
+            values.push_back(value);
+            setBytes(bytes + plainBytes(value));
+        } else {
+            auto it = index.find(value);
+            if (it != index.end()) {
+                codes.push_back(it->second);
+                setBytes(bytes + sizeof(Code));
+            } else if (dict.size() < MAX_DICT) {
+                Code code = Code(dict.size());
+                dict.push_back(value);
+                index[value] = code;
+                codes.push_back(code);
+                setBytes(bytes + sizeof(Code) + 2 * plainBytes(value));
+            } else {
+                decode();
+                values.push_back(value);
+                setBytes(bytes + plainBytes(value));
+            }
+
+            // High cardinality, dictionary costs more than it saves.
+            if (encoded && codes.size() >= MIN_ROWS && dict.size() * 2 > codes.size()) {
+                decode();
+            }
+        }
+
+        if (columnBudget.limit != 0 && columnBudget.used > columnBudget.limit) {
+            spillLargest();
+        }
+    }
+
+    size_t size() const {
+        if (columnSummary)
+            return stats.count;
+        if (spilled)
+            return spillRows;
+        return encoded ? codes.size() : values.size();
+    }
+    // Random access, only for columns held in memory.
+    const string& at(size_t row) const {
+        if (spilled)
+            throw std::runtime_error("Column spilled to disk, use JsonColumn::Reader");
+        return encoded ? dict[codes.at(row)] : values.at(row);
+    }
+    void reserve(size_t rows) {
+        if (columnMaxRows != 0)
+            rows = std::min(rows, columnMaxRows);
+        if (spilled || columnSummary)
+            return;
+        if (encoded)
+            codes.reserve(rows);
+        else
+            values.reserve(rows);
+    }
+    // Add empty cells up to rows (or -maxrows).
+    void padTo(size_t rows) {
+        if (columnMaxRows != 0)
+            rows = std::min(rows, columnMaxRows);
+        static const string empty;
+        while (size() < rows)
+            push_back(empty);
+    }
+    bool isSpilled() const {
+        return spilled;
+    }
+    const ColumnStats& getStats() const {
+        return stats;
+    }
+
+    // Dictionary access for binary output formats, only valid if isEncoded().
+    // Spilled and -summary columns hold no dictionary, read them with Reader.
+    bool isEncoded() const {
+        return encoded && ! columnSummary;
+    }
+    const std::vector<string>& dictionary() const {
+        return dict;
+    }
+    const std::vector<Code>& dictCodes() const {
+        return codes;
+    }
+
+    // Sequential row reader, merges spilled columns back during output.
+    // Spilled rows are read one chunk at a time, then the pending tail.
+    class Reader {
+    public:
+        Reader(const JsonColumn& column) : column(column) {
+        }
+        const string& next() {
+            if (! column.spilled)
+                return column.at(row++);
+
+            while (pChunk == nullptr || chunkPos >= pChunk->length()) {
+                if (chunkIdx < column.chunks.size()) {
+                    const Chunk& spillChunk = column.chunks[chunkIdx++];
+                    columnSpill.read(spillChunk.offset, spillChunk.length, chunk);
+                    pChunk = &chunk;
+                } else if (pChunk != &column.pending) {
+                    pChunk = &column.pending;
+                } else {
+                    throw std::runtime_error("Unable to read spilled column");
+                }
+                chunkPos = 0;
+            }
+
+            uint32_t len = 0;
+            if (chunkPos + sizeof(len) <= pChunk->length())
+                memcpy(&len, pChunk->data() + chunkPos, sizeof(len));
+            if (chunkPos + sizeof(len) + len > pChunk->length()) {
+                throw std::runtime_error("Unable to read spilled column");
+            }
+            value.assign(*pChunk, chunkPos + sizeof(len), len);
+            chunkPos += sizeof(len) + len;
+            row++;
+            return value;
+        }
+    private:
+        const JsonColumn& column;
+        size_t row = 0;
+        size_t chunkIdx = 0;
+        size_t chunkPos = 0;
+        const string* pChunk = nullptr;
+        string chunk;
+        string value;
+    };
+
+private:
+    struct Chunk {
+        uint64_t offset;
+        size_t length;
+    };
+
+    bool encoded = true;
+    std::vector<Code> codes;
+    std::vector<string> dict;
+    std::unordered_map<string, Code> index;
+    std::vector<string> values;
+    size_t bytes = 0;           // Approximate memory charged to columnBudget
+    bool spilled = false;       // Rows live in columnSpill chunks plus pending
+    std::vector<Chunk> chunks;
+    string pending;             // Spilled rows not yet written
+    size_t spillRows = 0;
+    ColumnStats stats;          // Only used for -summary
+
+    static size_t plainBytes(const string& value) {
+        return sizeof(string) + value.length();
+    }
+    void setBytes(size_t newBytes) {
+        columnBudget.used = columnBudget.used - bytes + newBytes;
+        bytes = newBytes;
+    }
+
+    // Switch to plain storage, release dictionary.
+    void decode() {
+        values.reserve(codes.capacity());
+        size_t newBytes = 0;
+        for (Code code : codes) {
+            values.push_back(dict[code]);
+            newBytes += plainBytes(dict[code]);
+        }
+        encoded = false;
+        std::vector<Code>().swap(codes);
+        std::vector<string>().swap(dict);
+        std::unordered_map<string, Code>().swap(index);
+        setBytes(newBytes);
+    }
+
+    // Over budget, spill (or flush pending rows of) the largest columns until
+    // half the budget is free, so the budget is not re-checked on every append.
+    static void spillLargest() {
+        while (columnBudget.used > columnBudget.limit / 2) {
+            JsonColumn* pLargest = nullptr;
+            for (JsonColumn* pColumn : columnBudget.columns) {
+                if (pLargest == nullptr || pColumn->bytes > pLargest->bytes)
+                    pLargest = pColumn;
+            }
+            if (pLargest == nullptr || pLargest->bytes == 0)
+                break;
+            if (pLargest->spilled)
+                pLargest->flushPending();
+            else
+                pLargest->spillAll();
+        }
+    }
+
+    // Move all rows to columnSpill, column stays on disk from now on.
+    void spillAll() {
+        spilled = true;
+        columnSpill.addUser();
+        spillRows = encoded ? codes.size() : values.size();
+        if (encoded) {
+            for (Code code : codes)
+                writeSpill(dict[code]);
+        } else {
+            for (const string& value : values)
+                writeSpill(value);
+        }
+        std::vector<Code>().swap(codes);
+        std::vector<string>().swap(dict);
+        std::unordered_map<string, Code>().swap(index);
+        std::vector<string>().swap(values);
+        encoded = false;        // Dictionary is gone, rows only on disk.
+        flushPending();
+    }
+    void writeSpill(const string& value) {
+        uint32_t len = uint32_t(value.length());
+        pending.append((const char*)&len, sizeof(len));
+        pending.append(value);
+        if (pending.length() >= SPILL_CHUNK) {
+            flushPending();
+        } else {
+            setBytes(pending.capacity());
+        }
+    }
+    void flushPending() {
+        if (! pending.empty()) {
+            Chunk chunk;
+            chunk.length = pending.length();
+            chunk.offset = columnSpill.append(pending);
+            chunks.push_back(chunk);
+        }
+        string().swap(pending);
+        setBytes(0);
+    }
+};
+
+typedef std::map<string, JsonColumn> MapList;
+typedef std::map<string, size_t> CountMap;
+
+// Rows one array element fills in record mode, at least one even if empty.
+inline size_t RecordRows(const CountMap& elementCounts) {
+    size_t rows = 1;
+    for (const auto& count : elementCounts)
+        rows = std::max(rows, count.second);
+    return rows;
+}
+
+// Record mode pre-pass of one array, union of its element column paths and the
+// rows all its elements fill. Counted once per array and cached until filled.
+struct RecordCount {
+    CountMap paths;
+    size_t totalRows = 0;
+};
+
+// Record aligned fill (-records) of one array of objects. Every element fills its
+// own block of rows in all the array's columns, fields it lacks get empty cells, so
+// later rows stay lined up with their record. Columns are sized up front from the
+// counting pre-pass (totalRows) so they never reallocate while filling.
+class RecordFill {
+public:
+    RecordFill(MapList& mapList, const CountMap& paths, size_t totalRows) {
+        columns.reserve(paths.size());
+        for (const auto& path : paths) {
+            JsonColumn& column = mapList[path.first];
+            base = std::max(base, column.size());
+            columns.push_back(&column);
+        }
+        for (JsonColumn* pColumn : columns) {
+            pColumn->padTo(base);
+            pColumn->reserve(base + totalRows);
+        }
+    }
+
+    // Call after each element has added its values.
+    void endElement() {
+        size_t rows = 1;
+        for (const JsonColumn* pColumn : columns) {
+            if (pColumn->size() > base)
+                rows = std::max(rows, pColumn->size() - base);
+        }
+        base += rows;
+        for (JsonColumn* pColumn : columns) {
+            pColumn->padTo(base);
+        }
+    }
+
+private:
+    std::vector<JsonColumn*> columns;
+    size_t base = 0;
+};
 
 const char* dot = ".";
 
@@ -89,6 +799,17 @@ public:
 
     virtual
     void toMapList(MapList& mapList, StringList& keys) const = 0;
+
+    // Count values toMapList would add per column, record mode pre-pass.
+    virtual
+    void countMapList(CountMap& counts, StringList& keys) const = 0;
+
+    // Hash of this subtree, computed bottom up once and cached (-diff).
+    virtual
+    uint64_t hash() const = 0;
+
+protected:
+    mutable uint64_t mHash = 0;
 };
 
 
@@ -117,16 +838,36 @@ public:
 
     void toMapList(MapList& mapList, StringList& keys) const {
         // can't convert a value to a key,value pair.
-        StringList& list = mapList[Join(keys, dot)];
-        list.push_back(toString());
+        JsonColumn& column = mapList[Join(keys, dot)];
+        if (isQuoted) {
+            // Decoded text, not json escaped.
+            column.push_back(string(quote) + *this + string(quote));
+        } else {
+            column.push_back(*this);
+        }
+    }
+
+    void countMapList(CountMap& counts, StringList& keys) const {
+        counts[Join(keys, dot)]++;
     }
 
     string toString() const {
         if (isQuoted) {
-            return string(quote) + *this + string(quote);
+            string str(quote);
+            str.reserve(length() + 2);
+            JsonEscapeString(data(), length(), str);
+            str += quote;
+            return str;
         }
         return *this; // ->c_str();
     }
+
+    uint64_t hash() const {
+        if (mHash == 0) {
+            mHash = JsonHashCombine(isQuoted ? '"' : 'v', JsonHash(data(), length()));
+        }
+        return mHash;
+    }
 };
 
 typedef std::vector<JsonBase*> VecJson;
@@ -138,6 +879,15 @@ class JsonArray : public JsonBase, public VecJson {
 public:
     JsonArray() : JsonBase(Array) {
     }
+    // Owns its elements, copying would delete them twice.
+    JsonArray(const JsonArray&) = delete;
+    JsonArray& operator=(const JsonArray&) = delete;
+    ~JsonArray() {
+        // Array owns its elements, required by long running -serve mode.
+        for (JsonBase* pValue : *this) {
+            delete pValue;
+        }
+    }
 
     string toString() const {
         std::ostringstream ostr;
@@ -160,6 +910,11 @@ public:
     }
 
     void toMapList(MapList& mapList, StringList& keys) const {
+        if (columnRecords) {
+            toRecords(mapList, keys);
+            return;
+        }
+
         // StringList& list = mapList[Join(keys, dot)];
         JsonArray::const_iterator it = begin();
         StringList itemKeys;
@@ -180,6 +935,61 @@ public:
             keys.push_back(key);
         }
     }
+
+    // Record mode, elements keep the array's key path and fill aligned rows.
+    void toRecords(MapList& mapList, StringList& keys) const {
+        const RecordCount& count = recordCount(keys);
+        RecordFill recordFill(mapList, count.paths, count.totalRows);
+        mRecordCount.reset();   // Filled, release the cache.
+        for (const JsonBase* pValue : *this) {
+            pValue->toMapList(mapList, keys);
+            recordFill.endElement();
+        }
+    }
+
+    // Union of element columns into paths, return total rows.
+    size_t countRecords(CountMap& paths, StringList& keys) const {
+        CountMap elementCounts;
+        size_t totalRows = 0;
+        for (const JsonBase* pValue : *this) {
+            elementCounts.clear();
+            pValue->countMapList(elementCounts, keys);
+            totalRows += RecordRows(elementCounts);
+            for (const auto& count : elementCounts)
+                paths[count.first];
+        }
+        return totalRows;
+    }
+
+    void countMapList(CountMap& counts, StringList& keys) const {
+        const RecordCount& count = recordCount(keys);
+        for (const auto& path : count.paths)
+            counts[path.first] += count.totalRows;
+    }
+
+    // Outer array's pre-pass counts nested arrays, cache it so filling them
+    // does not count their subtree again.
+    const RecordCount& recordCount(StringList& keys) const {
+        if (! mRecordCount) {
+            mRecordCount.reset(new RecordCount());
+            mRecordCount->totalRows = countRecords(mRecordCount->paths, keys);
+        }
+        return *mRecordCount;
+    }
+
+    uint64_t hash() const {
+        if (mHash == 0) {
+            uint64_t hash = JsonHashCombine('[', size());
+            for (const JsonBase* pValue : *this) {
+                hash = JsonHashCombine(hash, pValue->hash());
+            }
+            mHash = hash;
+        }
+        return mHash;
+    }
+
+private:
+    mutable std::unique_ptr<RecordCount> mRecordCount;  // Only set in record mode
 };
 
 // Map (group) of Json objects
@@ -187,6 +997,18 @@ class JsonMap : public JsonBase, public MapJson {
 public:
     JsonMap() : JsonBase(Map), MapJson() {
     }
+    // Owns its values, copying would delete them twice, move instead (see getJsonArray).
+    JsonMap(const JsonMap&) = delete;
+    JsonMap& operator=(const JsonMap&) = delete;
+    JsonMap(JsonMap&& other) : JsonBase(Map), MapJson(std::move(other)) {
+        other.clear();
+    }
+    ~JsonMap() {
+        // Map owns its values, required by long running -serve mode.
+        for (auto& item : *this) {
+            delete item.second;
+        }
+    }
 
     string toString() const {
         ostringstream out;
@@ -235,6 +1057,26 @@ public:
             it++;
         }
     }
+
+    void countMapList(CountMap& counts, StringList& keys) const {
+        for (const auto& item : *this) {
+            keys.push_back(item.first);
+            item.second->countMapList(counts, keys);
+            keys.pop_back();
+        }
+    }
+
+    uint64_t hash() const {
+        if (mHash == 0) {
+            uint64_t hash = JsonHashCombine('{', size());
+            for (const auto& item : *this) {
+                hash = JsonHashCombine(hash, item.first.hash());
+                hash = JsonHashCombine(hash, item.second->hash());
+            }
+            mHash = hash;
+        }
+        return mHash;
+    }
 };
 
 // Alternate name JsonFields for JsonMap
@@ -0,0 +1,451 @@
+//-------------------------------------------------------------------------------------------------
+//
+// File: jsontape.hpp  Author: Dennis Lang  Desc: Parse json into flat tape (lazy DOM)
+//
+//-------------------------------------------------------------------------------------------------
+//
+// Author: Dennis Lang - 2019
+// https://landenlabs.com
+//
+// This file is part of lljson project.
+//
+// ----- License ----
+//
+// Copyright (c) 2026 Dennis Lang
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#pragma once
+
+#include "json.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+
+// Compact alternative to the JsonBase tree. Document is one flat vector of tagged
+// 64-bit entries, no per-value heap objects. Entry layout:
+//
+//   tag (top 8 bits) | payload (low 56 bits)
+//
+//   StartMap/StartArray   payload = index of matching End entry (skip offset)
+//   EndMap/EndArray       payload = index of matching Start entry
+//   String/Literal        payload = offset into input buffer, next entry = length
+//
+// Strings point back into the input buffer (without the quotes) so the buffer must
+// outlive the tape, escapes are only decoded when a walker reads the string. Map
+// members are stored as alternating key String, value.
+class JsonTape {
+public:
+    enum Tag { StartMap = '{', EndMap = '}', StartArray = '[', EndArray = ']', String = '"', Literal = 'l' };
+    typedef uint64_t Entry;
+
+    static const int MAX_DEPTH = 200;
+
+    std::vector<Entry> tape;
+    const char* input = nullptr;
+    size_t maxItems = 0;    // Array elements kept (-maxrows), 0 is unlimited
+
+    Tag tag(size_t idx) const {
+        return Tag(tape[idx] >> 56);
+    }
+    size_t payload(size_t idx) const {
+        return size_t(tape[idx] & PAYLOAD_MASK);
+    }
+    const char* textPtr(size_t idx) const {
+        return input + payload(idx);
+    }
+    size_t textLen(size_t idx) const {
+        return size_t(tape[idx + 1]);
+    }
+    bool isContainer(size_t idx) const {
+        return tag(idx) == StartMap || tag(idx) == StartArray;
+    }
+    // Index of value following the one at idx, skips whole containers.
+    size_t next(size_t idx) const {
+        return isContainer(idx) ? payload(idx) + 1 : idx + 2;
+    }
+    // Root is only output if it is a container, same as the JsonFields tree.
+    bool hasRoot() const {
+        return ! tape.empty() && isContainer(0);
+    }
+
+    // -----------------------------------------------------------------------
+    // Single pass, non-recursive tokenizer. Only records token spans, values are
+    // not copied or converted until a walker needs them.
+    void parse(const JsonBuffer& buffer) {
+        tape.clear();
+        input = buffer.data();
+        const char* ptr = input;
+        const char* end = input + buffer.size();
+        std::vector<size_t> openStack;
+        std::vector<size_t> itemCounts;     // Elements seen per open array
+
+        // Top level is a single value, anything after it is ignored.
+        while (ptr < end && *ptr != '\0') {
+            char chr = *ptr;
+            if (maxItems != 0 && ! openStack.empty() && tag(openStack.back()) == StartArray
+                && ! isDelim(chr) && itemCounts.back()++ == maxItems) {
+                // Array is full, skip remaining elements without recording them.
+                if (openStack.size() == 1) {
+                    // Root array, nothing follows which could add output.
+                    tape[openStack.back()] = makeEntry(StartArray, tape.size());
+                    append(EndArray, openStack.back());
+                    return;
+                }
+                ptr = skipToClose(ptr, end);
+                chr = *ptr;
+            }
+            switch (chr) {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+            case ',':
+            case ':':
+                ptr++;
+                break;
+
+            case '{':
+            case '[':
+                if (openStack.size() >= MAX_DEPTH) {
+                    throw std::runtime_error("JSON nesting too deep, aborting parse");
+                }
+                openStack.push_back(tape.size());
+                itemCounts.push_back(0);
+                append(Tag(chr), 0);
+                ptr++;
+                break;
+
+            case '}':
+            case ']': {
+                Tag startTag = (chr == '}') ? StartMap : StartArray;
+                if (openStack.empty() || tag(openStack.back()) != startTag) {
+                    throw std::runtime_error("Unbalanced json, unexpected close");
+                }
+                size_t startIdx = openStack.back();
+                openStack.pop_back();
+                itemCounts.pop_back();
+                tape[startIdx] = makeEntry(startTag, tape.size());
+                append(Tag(chr), startIdx);
+                ptr++;
+                if (openStack.empty())
+                    return;
+            }
+            break;
+
+            case '"': {
+                const char* strBeg = ++ptr;
+                const char* strEnd = findQuote(strBeg, end);
+                appendText(String, strBeg, strEnd);
+                ptr = strEnd + 1;
+                if (openStack.empty())
+                    return;
+            }
+            break;
+
+            default: {
+                // Number, true, false or null - kept as raw text.
+                const char* litBeg = ptr;
+                while (ptr < end && ! isDelim(*ptr))
+                    ptr++;
+                appendText(Literal, litBeg, ptr);
+                if (openStack.empty())
+                    return;
+            }
+            break;
+            }
+        }
+
+        if (! openStack.empty()) {
+            throw std::runtime_error("Unexpected end of json, missing close");
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // Dump in same format as JsonBase::dump
+    ostream& dump(ostream& out) const {
+        if (hasRoot()) {
+            dumpValue(0, out);
+        }
+        return out;
+    }
+
+    // -----------------------------------------------------------------------
+    // Same column layout as JsonBase::toMapList, array elements restart the key path
+    // unless in record mode (-records).
+    void toMapList(MapList& mapList) const {
+        if (hasRoot()) {
+            StringList keys;
+            toMapList(0, mapList, keys);
+        }
+    }
+
+private:
+    static const uint64_t PAYLOAD_MASK = (uint64_t(1) << 56) - 1;
+
+    // Record mode counts by array start index, until the array is filled.
+    mutable std::unordered_map<size_t, RecordCount> recordCounts;
+
+    struct Member {
+        string key;         // Decoded key
+        size_t valueIdx;
+        bool operator<(const Member& other) const {
+            return key < other.key;
+        }
+        bool operator==(const Member& other) const {
+            return key == other.key;
+        }
+    };
+    typedef std::vector<Member> Members;
+
+    static Entry makeEntry(Tag tag, size_t payload) {
+        return (Entry(tag) << 56) | (Entry(payload) & PAYLOAD_MASK);
+    }
+    void append(Tag tag, size_t payload) {
+        tape.push_back(makeEntry(tag, payload));
+    }
+    void appendText(Tag tag, const char* beg, const char* end) {
+        append(tag, size_t(beg - input));
+        tape.push_back(Entry(end - beg));
+    }
+    // Position of close bracket ending the current container, nested values and
+    // strings are stepped over without being recorded.
+    static const char* skipToClose(const char* ptr, const char* end) {
+        int depth = 0;
+        for (; ptr < end && *ptr != '\0'; ptr++) {
+            switch (*ptr) {
+            case '"':
+                ptr = findQuote(ptr + 1, end);
+                break;
+            case '{':
+            case '[':
+                depth++;
+                break;
+            case '}':
+            case ']':
+                if (depth-- == 0)
+                    return ptr;
+                break;
+            }
+        }
+        throw std::runtime_error("Unexpected end of json, missing close");
+    }
+    static bool isDelim(char chr) {
+        return chr == ',' || chr == '}' || chr == ']' || chr == ':' || chr == '\0'
+            || chr == ' ' || chr == '\t' || chr == '\n' || chr == '\r';
+    }
+    // Closing quote, skipping quotes escaped by an odd run of backslashes.
+    static const char* findQuote(const char* ptr, const char* end) {
+        for (;;) {
+            const char* quote = (const char*)memchr(ptr, '"', end - ptr);
+            if (quote == nullptr) {
+                throw std::runtime_error("Unterminated json string");
+            }
+            const char* back = quote;
+            while (back > ptr && back[-1] == '\\')
+                back--;
+            if (((quote - back) % 2) == 0)
+                return quote;
+            ptr = quote + 1;
+        }
+    }
+
+    // Append decoded string text, raw text of literal.
+    void appendText(size_t idx, string& str) const {
+        if (tag(idx) == String && JsonPlainPrefix(textPtr(idx), textLen(idx)) != textLen(idx)) {
+            JsonDecodeString(textPtr(idx), textLen(idx), str);
+        } else {
+            str.append(textPtr(idx), textLen(idx));
+        }
+    }
+    string text(size_t idx) const {
+        string str;
+        appendText(idx, str);
+        return str;
+    }
+
+    // Column value, same as JsonValue::toMapList
+    string toString(size_t idx) const {
+        if (tag(idx) == String) {
+            string str;
+            str.reserve(textLen(idx) + 2);
+            str += '"';
+            appendText(idx, str);
+            str += '"';
+            return str;
+        }
+        return text(idx);
+    }
+
+    // Map members sorted by key, duplicate keys keep the last value (std::map semantics
+    // of JsonMap) so both representations produce the same output.
+    void getMembers(size_t mapIdx, Members& members) const {
+        members.clear();
+        size_t endIdx = payload(mapIdx);
+        for (size_t idx = mapIdx + 1; idx < endIdx; ) {
+            size_t valueIdx = idx + 2;
+            if (valueIdx >= endIdx)
+                break;  // key without value
+            Member member = { text(idx), valueIdx };
+            members.push_back(member);
+            idx = next(valueIdx);
+        }
+        std::reverse(members.begin(), members.end());
+        std::stable_sort(members.begin(), members.end());
+        members.erase(std::unique(members.begin(), members.end()), members.end());
+    }
+
+    void dumpValue(size_t idx, ostream& out) const {
+        switch (tag(idx)) {
+        case StartArray: {
+            out << "[\n";
+            size_t endIdx = payload(idx);
+            bool addComma = false;
+            for (size_t item = idx + 1; item < endIdx; item = next(item)) {
+                if (addComma)
+                    out << ",\n";
+                addComma = true;
+                dumpValue(item, out);
+            }
+            out << "\n]";
+        }
+        break;
+        case StartMap: {
+            out << "{\n";
+            Members members;
+            getMembers(idx, members);
+            bool addComma = false;
+            for (const Member& member : members) {
+                if (addComma)
+                    out << ",\n";
+                addComma = true;
+                if (! member.key.empty()) {
+                    string key("\"");
+                    JsonEscapeString(member.key.data(), member.key.length(), key);
+                    out << key << "\": ";
+                }
+                dumpValue(member.valueIdx, out);
+            }
+            out << "\n}\n";
+        }
+        break;
+        case String: {
+            string str("\"");
+            string value = text(idx);
+            JsonEscapeString(value.data(), value.length(), str);
+            out << str << '"';
+        }
+        break;
+        default:
+            out.write(textPtr(idx), textLen(idx));
+            break;
+        }
+    }
+
+    void toMapList(size_t idx, MapList& mapList, StringList& keys) const {
+        switch (tag(idx)) {
+        case StartArray: {
+            size_t endIdx = payload(idx);
+            if (columnRecords) {
+                const RecordCount& count = recordCount(idx, keys);
+                RecordFill recordFill(mapList, count.paths, count.totalRows);
+                recordCounts.erase(idx);    // Filled, release the cache.
+                for (size_t item = idx + 1; item < endIdx; item = next(item)) {
+                    toMapList(item, mapList, keys);
+                    recordFill.endElement();
+                }
+                break;
+            }
+            StringList itemKeys;
+            for (size_t item = idx + 1; item < endIdx; item = next(item)) {
+                itemKeys.clear();
+                toMapList(item, mapList, itemKeys);
+            }
+        }
+        break;
+        case StartMap: {
+            Members members;
+            getMembers(idx, members);
+            for (const Member& member : members) {
+                keys.push_back(member.key);
+                toMapList(member.valueIdx, mapList, keys);
+                keys.pop_back();
+            }
+        }
+        break;
+        default:
+            mapList[Join(keys, dot)].push_back(toString(idx));
+            break;
+        }
+    }
+
+    // Record mode pre-pass, same counts as JsonBase::countMapList
+    void countMapList(size_t idx, CountMap& counts, StringList& keys) const {
+        switch (tag(idx)) {
+        case StartArray: {
+            const RecordCount& count = recordCount(idx, keys);
+            for (const auto& path : count.paths)
+                counts[path.first] += count.totalRows;
+        }
+        break;
+        case StartMap: {
+            Members members;
+            getMembers(idx, members);
+            for (const Member& member : members) {
+                keys.push_back(member.key);
+                countMapList(member.valueIdx, counts, keys);
+                keys.pop_back();
+            }
+        }
+        break;
+        default:
+            counts[Join(keys, dot)]++;
+            break;
+        }
+    }
+
+    // Count array once, nested arrays are counted by the outer array's pre-pass
+    // and read back from the cache when they are filled.
+    const RecordCount& recordCount(size_t arrayIdx, StringList& keys) const {
+        auto it = recordCounts.find(arrayIdx);
+        if (it == recordCounts.end()) {
+            RecordCount& count = recordCounts[arrayIdx];
+            count.totalRows = countRecords(arrayIdx, count.paths, keys);
+            return count;
+        }
+        return it->second;
+    }
+
+    size_t countRecords(size_t arrayIdx, CountMap& paths, StringList& keys) const {
+        CountMap elementCounts;
+        size_t totalRows = 0;
+        size_t endIdx = payload(arrayIdx);
+        for (size_t item = arrayIdx + 1; item < endIdx; item = next(item)) {
+            elementCounts.clear();
+            countMapList(item, elementCounts, keys);
+            totalRows += RecordRows(elementCounts);
+            for (const auto& count : elementCounts)
+                paths[count.first];
+        }
+        return totalRows;
+    }
+};
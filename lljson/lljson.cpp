@@ -63,6 +63,7 @@
 #include "directory.hpp"
 #include "split.hpp"
 #include "json.hpp"
+#include "jsontape.hpp"
 
 #include <stdio.h>
 #include <ctype.h>
@@ -77,6 +78,11 @@
 #include <exception>
 #include <stdexcept>
 #include <assert.h>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 
 // Helper types
@@ -91,6 +97,15 @@ StringList fileDirList;
 bool showFile = true;
 bool verbose = false;
 bool instream = false;
+bool useTape = false;
+bool diffMode = false;
+bool watchMode = false;
+lstring watchOutPath;
+enum Reformat { NoReformat, Minify, Pretty };
+Reformat reformat = NoReformat;
+lstring servePath;
+size_t readAhead = 4;
+size_t maxRows = 0;
 
 uint optionErrCnt = 0;
 uint patternErrCnt = 0;
@@ -102,6 +117,17 @@ uint patternErrCnt = 0;
     #if !defined(S_ISREG) && defined(S_IFMT) && defined(S_IFREG)
         #define S_ISREG(m) (((m) & S_IFMT) == S_IFREG)
     #endif
+#else
+    #include <signal.h>
+    #include <unistd.h>
+    #include <sys/socket.h>
+    #include <sys/time.h>
+    #include <sys/un.h>
+    #define HAVE_UNIX_SOCKET
+#endif
+#if defined(__linux__)
+    #include <sys/inotify.h>
+    #define HAVE_INOTIFY
 #endif
 
 // ---------------------------------------------------------------------------
@@ -130,8 +156,7 @@ bool FileMatches(const lstring& inName, const PatternList& patternList, bool emp
 
 static void assertValid(const char* ptr, const char* body) {
     if (ptr == nullptr) {
-        std::cerr << "Invalid json near " << body << endl;
-        abort();
+        throw std::runtime_error(string("Invalid json, unterminated string near ") + string(body, strnlen(body, 40)));
     }
 }
 
@@ -153,7 +178,7 @@ static bool isEscapedChar(const char* strStart, const char* charPtr) {
 }
 
 // ---------------------------------------------------------------------------
-// Parse json word surrounded by quotes.
+// Parse json word surrounded by quotes, escapes are decoded and UTF-8 validated.
 static void getJsonWord( JsonBuffer& buffer, char delim, JsonToken& word) {
 
     const char* lastPtr = strchr(buffer.ptr(), delim);
@@ -163,11 +188,54 @@ static void getJsonWord( JsonBuffer& buffer, char delim, JsonToken& word) {
     assertValid(lastPtr,  buffer.ptr());
     word.clear();
     int len = int(lastPtr - buffer.ptr());
-    word.append(buffer.ptr(len + 1), len);
+    const char* strPtr = buffer.ptr(len + 1);
+    if (JsonPlainPrefix(strPtr, len) == size_t(len)) {
+        word.append(strPtr, len);   // No escapes or non-ASCII, skip decode.
+    } else {
+        JsonDecodeString(strPtr, len, word);
+    }
     word.isQuoted = true;
 
 }
 
+// ---------------------------------------------------------------------------
+// Skip rest of array (-maxrows) without building nodes, leave buffer after its ']'
+static void skipJsonArray(JsonBuffer& buffer) {
+    int depth = 0;
+    while (buffer.pos < buffer.size()) {
+        char chr = buffer.nextChr();
+        switch (chr) {
+        case '"': {
+            const char* quotePtr = strchr(buffer.ptr(), '"');
+            while (quotePtr != nullptr && isEscapedChar(buffer.ptr(), quotePtr)) {
+                quotePtr = strchr(quotePtr + 1, '"');
+            }
+            assertValid(quotePtr, buffer.ptr());
+            buffer.ptr(int(quotePtr - buffer.ptr()) + 1);
+        }
+        break;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (depth-- == 0)
+                return;
+            break;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// parseJson/getJsonArray/getJsonGroup are mutually recursive with no depth limit -
+// deeply nested (or maliciously crafted) input would otherwise recurse until the
+// native stack overflows. jsonDepth/MAX_JSON_DEPTH bound that via a simple RAII
+// guard incremented once per parseJson call (the one choke point all three funnel
+// through), throwing a normal, already-caught exception instead of crashing.
+static const int MAX_JSON_DEPTH = 200;
+static int jsonDepth = 0;
+
 // Forward definition
 static JsonToken parseJson(JsonBuffer& buffer, JsonFields& jsonFields);
 
@@ -176,16 +244,25 @@ static JsonToken parseJson(JsonBuffer& buffer, JsonFields& jsonFields);
 static void getJsonArray(JsonBuffer& buffer, JsonArray& array) {
     JsonFields jsonFields;
     for(;;) {
+        if (maxRows != 0 && array.size() == maxRows) {
+            if (jsonDepth == 1) {
+                // Root array, nothing follows which could add output.
+                buffer.pos = buffer.size();
+            } else {
+                skipJsonArray(buffer);
+            }
+            return;
+        }
         JsonToken token = parseJson(buffer, jsonFields);
         if (token.mToken == JsonToken::Value) {
-            if (! token.empty()) {
+            if (! token.empty() || token.isQuoted) {   // "" is a value, same as -tape
                 JsonValue* jsonValue = new JsonValue(token);
                 array.push_back(jsonValue);
             } else {
                 if (jsonFields.size() == 1 && jsonFields.cbegin()->first.empty()) {
                     array.push_back(jsonFields.cbegin()->second);
                 } else {
-                    JsonFields* dupFields  = new JsonFields(jsonFields);
+                    JsonFields* dupFields  = new JsonFields(std::move(jsonFields));
                     array.push_back(dupFields);
                 }
                 jsonFields.clear();
@@ -205,6 +282,10 @@ static void getJsonGroup(JsonBuffer& buffer, JsonFields& fields) {
         if (token.mToken == JsonToken::EndGroup) {
             return;
         }
+        if (token.mToken == JsonToken::EndParse) {
+            // Truncated input used to spin here forever, fatal for -serve mode.
+            throw std::runtime_error("Unexpected end of json, missing }");
+        }
     }
 }
 
@@ -217,15 +298,6 @@ static void addJsonValue(JsonFields& jsonFields, JsonToken& fieldName, JsonToken
     value.clear();
 }
 
-// ---------------------------------------------------------------------------
-// parseJson/getJsonArray/getJsonGroup are mutually recursive with no depth limit -
-// deeply nested (or maliciously crafted) input would otherwise recurse until the
-// native stack overflows. jsonDepth/MAX_JSON_DEPTH bound that via a simple RAII
-// guard incremented once per parseJson call (the one choke point all three funnel
-// through), throwing a normal, already-caught exception instead of crashing.
-static const int MAX_JSON_DEPTH = 200;
-static int jsonDepth = 0;
-
 static JsonToken parseJson(JsonBuffer& buffer, JsonFields& jsonFields) {
     struct DepthGuard {
         DepthGuard()  { jsonDepth++; }
@@ -271,7 +343,7 @@ static JsonToken parseJson(JsonBuffer& buffer, JsonFields& jsonFields) {
         }
         break;
         case '}':
-            if (fieldValue.empty()) {
+            if (fieldValue.empty() && ! fieldValue.isQuoted) {
                 return END_GROUP;
             } else {
                 addJsonValue(jsonFields, fieldName, fieldValue);
@@ -291,7 +363,7 @@ static JsonToken parseJson(JsonBuffer& buffer, JsonFields& jsonFields) {
         break;
         case ']':
             // addJsonValue(jsonFields, fieldName, fieldValue);
-            if (jsonFields.size() != 0 || ! fieldValue.empty()) {
+            if (jsonFields.size() != 0 || ! fieldValue.empty() || fieldValue.isQuoted) {
                 buffer.backup();
                 return fieldValue;
             } else {
@@ -314,23 +386,211 @@ void JsonDump(const JsonFields& base, ostream& out) {
     }
 }
 
+// ---------------------------------------------------------------------------
+// Reformat json (-minify, -pretty) straight from the input buffer. Strings and
+// literals are copied as untouched spans, only whitespace between tokens is
+// rewritten, so key order and duplicate keys are preserved. Output is gathered
+// in large chunks to avoid per character stream overhead.
+static void JsonReformat(const JsonBuffer& buffer, ostream& out, bool pretty) {
+    static const string indent(256, ' ');
+    static const size_t CHUNK = 256 * 1024;
+    static bool isLiteral[256];
+    if (! isLiteral[(unsigned char)'0']) {
+        for (int chr = 1; chr < 256; chr++)
+            isLiteral[chr] = (strchr(" \t\n\r,:{}[]\"", chr) == nullptr);
+    }
+
+    const char* ptr = buffer.data();
+    const char* end = ptr + buffer.size();
+    size_t depth = 0;
+    string outBuf;
+    outBuf.reserve(CHUNK + indent.length() + 2);
+
+    auto newLine = [&]() {
+        if (pretty) {
+            outBuf += '\n';
+            outBuf.append(indent.data(), std::min(depth * 2, indent.length()));
+        }
+    };
+    auto flush = [&]() {
+        out.write(outBuf.data(), outBuf.length());
+        outBuf.clear();
+    };
+
+    while (ptr < end && *ptr != '\0') {
+        if (outBuf.length() >= CHUNK)
+            flush();
+
+        switch (*ptr) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+            ptr++;
+            break;
+
+        case '"': {
+            const char* quotePtr = strchr(ptr + 1, '"');
+            while (quotePtr != nullptr && isEscapedChar(ptr + 1, quotePtr)) {
+                quotePtr = strchr(quotePtr + 1, '"');
+            }
+            if (quotePtr == nullptr) {
+                flush();
+                cerr << "Invalid json, unterminated string" << endl;
+                return;
+            }
+            outBuf.append(ptr, quotePtr + 1 - ptr);
+            ptr = quotePtr + 1;
+        }
+        break;
+
+        case '{':
+        case '[': {
+            char close = (*ptr == '{') ? '}' : ']';
+            outBuf += *ptr++;
+            const char* nextPtr = ptr;
+            while (nextPtr < end && isspace((unsigned char)*nextPtr))
+                nextPtr++;
+            if (nextPtr < end && *nextPtr == close) {
+                outBuf += close;    // Keep empty container on one line.
+                ptr = nextPtr + 1;
+            } else {
+                depth++;
+                newLine();
+            }
+        }
+        break;
+
+        case '}':
+        case ']':
+            if (depth != 0)
+                depth--;
+            newLine();
+            outBuf += *ptr++;
+            break;
+
+        case ',':
+            outBuf += *ptr++;
+            newLine();
+            break;
+
+        case ':':
+            outBuf += *ptr++;
+            if (pretty)
+                outBuf += ' ';
+            break;
+
+        default: {
+            // Number, true, false or null copied as one span.
+            const char* litPtr = ptr;
+            while (ptr < end && isLiteral[(unsigned char)*ptr])
+                ptr++;
+            outBuf.append(litPtr, ptr - litPtr);
+        }
+        break;
+        }
+    }
+    outBuf += '\n';
+    flush();
+}
+
 // ---------------------------------------------------------------------------
 // Quote a CSV field per RFC 4180 if it contains a comma, quote, or newline -
 // otherwise JsonTranspose's output has no field escaping at all, so a JSON string
 // value containing a literal comma silently corrupts the CSV's column structure.
+// Field needs quoting if it holds a comma, quote or any control character (tab,
+// newline, ...), which RFC 4180 allows raw inside a quoted field.
+static bool isCsvSpecial(char c) {
+    return c == ',' || c == '"' || (unsigned char)c < 0x20;
+}
+
 static string csvField(const string& value) {
-    if (value.find_first_of(",\"\n\r") == string::npos) {
+    if (std::find_if(value.begin(), value.end(), isCsvSpecial) == value.end()) {
         return value;
     }
     string quoted = "\"";
     for (char c : value) {
         if (c == '"') quoted += '"';   // double an embedded quote
-        quoted += c;
+        if (c == '\0')
+            quoted += "\xEF\xBF\xBD";   // NUL (\u0000) breaks C string tools, use U+FFFD
+        else
+            quoted += c;
     }
     quoted += '"';
     return quoted;
 }
 
+// ---------------------------------------------------------------------------
+// Output columns in CSV format, arrays as columns. Columns are read back row by
+// row so spilled (-mem-limit) columns are merged from disk without reloading them.
+static void TransposeMapList(const MapList& mapList, ostream& out) {
+    MapList::const_iterator it = mapList.begin();
+    bool addComma = false;
+    size_t maxRows = 0;
+    std::vector<JsonColumn::Reader> readers;
+    readers.reserve(mapList.size());
+    while (it != mapList.end()) {
+        if (addComma) out << ", ";
+        addComma = true;
+
+        out << csvField(it->first);
+        maxRows = std::max(maxRows, it->second.size());
+        readers.push_back(JsonColumn::Reader(it->second));
+        it++;
+    }
+    out << std::endl;
+
+
+    for (unsigned row = 0; row < maxRows; row++) {
+        addComma = false;
+        size_t col = 0;
+        for (it = mapList.begin(); it != mapList.end(); it++, col++) {
+            if (addComma) out << ", ";
+            addComma = true;
+            if (row < it->second.size()) {
+                out << csvField(readers[col].next());
+            }
+
+        }
+        out << std::endl;
+    }
+    out << std::endl;
+}
+
+// ---------------------------------------------------------------------------
+// Output per column statistics (-summary) in CSV format, one row per column.
+static void SummaryMapList(const MapList& mapList, ostream& out) {
+    out << "column, count, empty, numeric, min, max, mean, distinct" << std::endl;
+    std::streamsize oldPrecision = out.precision(12);
+    for (MapList::const_iterator it = mapList.begin(); it != mapList.end(); it++) {
+        const ColumnStats& stats = it->second.getStats();
+        out << csvField(it->first)
+            << ", " << stats.count
+            << ", " << stats.empty
+            << ", " << stats.numeric;
+        if (stats.numeric != 0) {
+            out << ", " << stats.minValue
+                << ", " << stats.maxValue
+                << ", " << stats.mean();
+        } else {
+            out << ", , , ";
+        }
+        out << ", " << stats.distinct() << std::endl;
+    }
+    out.precision(oldPrecision);
+    out << std::endl;
+}
+
+// ---------------------------------------------------------------------------
+// Output columns as transposed CSV or as statistics.
+static void OutputMapList(const MapList& mapList, ostream& out) {
+    if (columnSummary) {
+        SummaryMapList(mapList, out);
+    } else {
+        TransposeMapList(mapList, out);
+    }
+}
+
 // ---------------------------------------------------------------------------
 // Output json in CSV format with the arrays as columns.
 void JsonTranspose(const JsonFields& base, ostream& out) {
@@ -339,109 +599,260 @@ void JsonTranspose(const JsonFields& base, ostream& out) {
         MapList mapList;
         StringList keys;
         rootIt->second->toMapList(mapList, keys);
+        OutputMapList(mapList, out);
+    }
+}
 
-        MapList::iterator it = mapList.begin();
-        bool addComma = false;
-        size_t maxRows = 0;
-        while (it != mapList.end()) {
-            if (addComma) out << ", ";
-            addComma = true;
+// ---------------------------------------------------------------------------
+// Output tape in CSV format, walks tape without building JsonBase objects.
+void TapeTranspose(const JsonTape& tape, ostream& out) {
+    if (tape.hasRoot()) {
+        MapList mapList;
+        tape.toMapList(mapList);
+        OutputMapList(mapList, out);
+    }
+}
 
-            out << csvField(it->first);
-            maxRows = std::max(maxRows, it->second.size());
-            it++;
+// ---------------------------------------------------------------------------
+// Output parsed json as dump or transposed CSV.
+static void OutputJson(const JsonFields& fields, const lstring& source, ostream& out) {
+    try {
+        if (verbose) {
+            JsonDump(fields, out);
+        } else {
+            JsonTranspose(fields, out);
         }
-        out << std::endl;
-
+    } catch (const exception& ex) {
+        cerr << ex.what() << ", Error in " << source << endl;
+    }
+}
 
-        for (unsigned row = 0; row < maxRows; row++) {
-            addComma = false;
-            for (it = mapList.begin(); it != mapList.end(); it++) {
-                if (addComma) out << ", ";
-                addComma = true;
-                if (row < it->second.size()) {
-                    out << csvField(it->second.at(row));
-                }
+// ---------------------------------------------------------------------------
+// Parse buffer into flat tape and output it.
+static void OutputTape(const JsonBuffer& buffer, const lstring& source, ostream& out) {
+    JsonTape tape;
+    tape.maxItems = maxRows;
+    try {
+        tape.parse(buffer);
+    } catch (const exception& ex) {
+        cerr << ex.what() << ", Error in " << source << endl;
+        return;
+    }
 
-            }
-            out << std::endl;
+    try {
+        if (verbose) {
+            tape.dump(out);
+        } else {
+            TapeTranspose(tape, out);
         }
-        out << std::endl;
+    } catch (const exception& ex) {
+        cerr << ex.what() << ", Error in " << source << endl;
     }
 }
 
 // ---------------------------------------------------------------------------
-// Open, read and parse file.
-bool ParseFile(const lstring& filepath, const lstring& filename) {
+// Read whole file into buffer, buffer is '\0' terminated.
+static bool LoadFile(const lstring& filepath, JsonBuffer& buffer, string& error) {
     ifstream        in;
-    ofstream        out;
     struct stat     filestat;
-    JsonFields fields;
 
-    try {
-        if (stat(filepath, &filestat) != 0)
-            return false;
+    if (stat(filepath, &filestat) != 0)
+        return false;
 
-        in.open(filepath);
-        if (in.good()) {
-            JsonBuffer buffer;
-            buffer.resize(filestat.st_size + 1);
-            streamsize inCnt = in.read(buffer.data(), buffer.size()).gcount();
-            assert(inCnt < buffer.size());
-            in.close();
-            buffer.push_back('\0');
-            parseJson(buffer, fields);
-        } else {
-            cerr << strerror(errno) << ", Unable to open " << filepath << endl;
-        }
-    } catch (exception ex) {
-        cerr << ex.what() << ", Error in file:" << filepath << endl;
+    in.open(filepath);
+    if (! in.good()) {
+        error = string(strerror(errno)) + ", Unable to open " + filepath;
+        return false;
     }
 
-    if (verbose) {
-        JsonDump(fields, cout);
-    } else {
-        JsonTranspose(fields, cout);
+    buffer.clear();
+    buffer.pos = 0;
+    buffer.resize(filestat.st_size + 1);
+    streamsize inCnt = in.read(buffer.data(), buffer.size()).gcount();
+    assert(inCnt < buffer.size());
+    in.close();
+    buffer.push_back('\0');
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Parse loaded file and output it.
+static bool ParseBuffer(JsonBuffer& buffer, const lstring& filepath, ostream& out) {
+    if (watchMode) {
+        // Appended -watch output, name the source of each block.
+        out << "# File: " << filepath << std::endl;
+    }
+    if (reformat != NoReformat) {
+        JsonReformat(buffer, out, reformat == Pretty);
+        return false;
+    }
+    if (useTape) {
+        OutputTape(buffer, filepath, out);
+        return false;
+    }
+
+    JsonFields fields;
+    try {
+        parseJson(buffer, fields);
+    } catch (const exception& ex) {
+        cerr << ex.what() << ", Error in file:" << filepath << endl;
     }
 
+    OutputJson(fields, filepath, out);
     return false;
 }
 
+// ---------------------------------------------------------------------------
+// Open, read and parse file.
+bool ParseFile(const lstring& filepath, const lstring& filename, ostream& out) {
+    JsonBuffer buffer;
+    string error;
+    if (! LoadFile(filepath, buffer, error)) {
+        if (! error.empty())
+            cerr << error << endl;
+        return false;
+    }
+    return ParseBuffer(buffer, filepath, out);
+}
 
 // ---------------------------------------------------------------------------
-// Locate matching files which are not in exclude list.
-static size_t InspectFile(const lstring& fullname) {
-    size_t fileCount = 0;
-    lstring name;
-    getName(name, fullname);
+// Load files in background so the next -readahead files are read from disk
+// while the current one is parsed. Depth 0 loads each file inline on next().
+// Paths come from a fixed list or from a NextPath source, such as paths read
+// from stdin, which is pulled as files are needed so streamed input is not held
+// back until its end.
+class FileReadAhead {
+public:
+    struct Item {
+        lstring path;
+        JsonBuffer buffer;
+        bool loaded = false;
+        string error;
+    };
+    // Set path and return true, false when no more paths.
+    typedef std::function<bool(lstring& path)> NextPath;
+
+    FileReadAhead(const StringList& files, size_t depth) : depth(depth) {
+        size_t fileIdx = 0;
+        nextPath = [&files, fileIdx](lstring& path) mutable {
+            if (fileIdx >= files.size())
+                return false;
+            path = files[fileIdx++];
+            return true;
+        };
+        if (depth != 0 && files.size() > 1) {
+            thread = std::thread(&FileReadAhead::run, this);
+        }
+    }
+    FileReadAhead(const NextPath& nextPath, size_t depth) : nextPath(nextPath), depth(depth) {
+        if (depth != 0) {
+            thread = std::thread(&FileReadAhead::run, this);
+        }
+    }
+    ~FileReadAhead() {
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            changed.notify_all();
+            thread.join();
+        }
+    }
 
-    if (! name.empty()
-        && ! FileMatches(name, excludeFilePatList, false)
-        && FileMatches(name, includeFilePatList, true)) {
-        if (ParseFile(fullname, name)) {
-            fileCount++;
-            if (showFile)
-                std::cout << fullname << std::endl;
+    // Return next file in path order, false when all files consumed.
+    bool next(Item& item) {
+        if (! thread.joinable()) {
+            lstring path;
+            if (! nextPath(path))
+                return false;
+            load(path, item);
+            return true;
         }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return ! ready.empty() || done; });
+        if (ready.empty())
+            return false;
+        item = std::move(ready.front());
+        ready.pop_front();
+        changed.notify_all();
+        return true;
     }
 
-    return fileCount;
+private:
+    NextPath nextPath;
+    size_t depth;
+    bool done = false;      // Background thread has no more paths
+    bool stop = false;
+    std::deque<Item> ready;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread thread;
+
+    static void load(const lstring& path, Item& item) {
+        item.path = path;
+        item.error.clear();
+        try {
+            item.loaded = LoadFile(path, item.buffer, item.error);
+        } catch (const exception& ex) {
+            // bad_alloc on huge file, report it and move on.
+            item.loaded = false;
+            JsonBuffer().swap(item.buffer);
+            item.error = string(ex.what()) + ", Unable to load " + path;
+        }
+    }
+
+    void run() {
+        lstring path;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return stop || ready.size() < depth; });
+                if (stop)
+                    return;
+            }
+            if (! nextPath(path))
+                break;
+
+            Item item;
+            load(path, item);   // Disk read outside lock, overlaps parse.
+
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(std::move(item));
+            changed.notify_all();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        changed.notify_all();
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Return true if file name passes include and exclude patterns.
+static bool FileSelected(const lstring& fullname) {
+    lstring name;
+    getName(name, fullname);
+
+    return ! name.empty()
+        && ! FileMatches(name, excludeFilePatList, false)
+        && FileMatches(name, includeFilePatList, true);
 }
 
 // ---------------------------------------------------------------------------
-// Recurse over directories, locate files.
-static size_t InspectFiles(const lstring& dirname) {
+// Recurse over directories, locate matching files which are not in exclude list.
+static void FindFiles(const lstring& dirname, StringList& files) {
     Directory_files directory(dirname);
     lstring fullname;
 
-    size_t fileCount = 0;
-
 #if 1
     struct stat filestat;
     try {
         if (stat(dirname, &filestat) == 0 && S_ISREG(filestat.st_mode)) {
-            fileCount += InspectFile(dirname);
-            return fileCount;
+            if (FileSelected(dirname))
+                files.push_back(dirname);
+            return;
         }
     } catch (exception ex) {
         // Probably a pattern, let directory scan do its magic.
@@ -451,15 +862,448 @@ static size_t InspectFiles(const lstring& dirname) {
     while (directory.more()) {
         directory.fullName(fullname);
         if (directory.is_directory()) {
-            fileCount += InspectFiles(fullname);
-        } else if (fullname.length() > 0) {
-            fileCount += InspectFile(fullname);
+            FindFiles(fullname, files);
+        } else if (fullname.length() > 0 && FileSelected(fullname)) {
+            files.push_back(fullname);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Parse files in order, reading ahead in background.
+static size_t ParseFiles(FileReadAhead& reader, ostream& out) {
+    size_t fileCount = 0;
+    FileReadAhead::Item item;
+
+    while (reader.next(item)) {
+        if (! item.loaded) {
+            if (! item.error.empty())
+                cerr << item.error << endl;
+        } else if (ParseBuffer(item.buffer, item.path, out)) {
+            fileCount++;
+            if (showFile)
+                out << item.path << std::endl;
         }
     }
 
     return fileCount;
 }
 
+// ---------------------------------------------------------------------------
+// Locate files under all paths, then parse them as one list so read-ahead
+// carries across arguments.
+static size_t InspectFiles(const StringList& paths, ostream& out) {
+    StringList files;
+    for (auto const& path : paths)
+        FindFiles(path, files);
+    FileReadAhead reader(files, readAhead);
+    return ParseFiles(reader, out);
+}
+
+// ---------------------------------------------------------------------------
+// Locate and parse files as their paths arrive, one path per line (lljson -).
+static size_t InspectStream(istream& in, ostream& out) {
+    StringList files;
+    size_t fileIdx = 0;
+    FileReadAhead reader([&in, &files, &fileIdx](lstring& path) {
+        while (fileIdx == files.size()) {
+            string filePath;
+            if (! std::getline(in, filePath))
+                return false;
+            files.clear();
+            fileIdx = 0;
+            FindFiles(filePath, files);
+        }
+        path = files[fileIdx++];
+        return true;
+    }, readAhead);
+    return ParseFiles(reader, out);
+}
+
+// ---------------------------------------------------------------------------
+// Single line text of node for -diff, containers only show their type.
+static string DiffText(const JsonBase* pNode) {
+    switch (pNode->mJtype) {
+    case JsonBase::Map:
+        return "{...}";
+    case JsonBase::Array:
+        return "[...]";
+    default:
+        return pNode->toString();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Report paths which differ between two trees, using same dotted path notation
+// as toMapList plus the array index. Subtrees with equal hash are skipped
+// without being walked. Return number of differences.
+static size_t JsonDiff(const JsonBase* pA, const JsonBase* pB, StringList& keys, ostream& out) {
+    if (pA->hash() == pB->hash())
+        return 0;
+
+    string path = keys.empty() ? string(dot) : Join(keys, dot);
+    if (pA->mJtype != pB->mJtype || pA->mJtype == JsonBase::Value) {
+        out << "~ " << path << ": " << DiffText(pA) << " != " << DiffText(pB) << std::endl;
+        return 1;
+    }
+
+    size_t diffCnt = 0;
+    if (pA->mJtype == JsonBase::Array) {
+        const JsonArray& arrayA = *(const JsonArray*)pA;
+        const JsonArray& arrayB = *(const JsonArray*)pB;
+        size_t count = std::max(arrayA.size(), arrayB.size());
+        for (size_t idx = 0; idx < count; idx++) {
+            keys.push_back(std::to_string(idx));
+            if (idx >= arrayB.size()) {
+                out << "- " << Join(keys, dot) << std::endl;
+                diffCnt++;
+            } else if (idx >= arrayA.size()) {
+                out << "+ " << Join(keys, dot) << std::endl;
+                diffCnt++;
+            } else {
+                diffCnt += JsonDiff(arrayA[idx], arrayB[idx], keys, out);
+            }
+            keys.pop_back();
+        }
+    } else {
+        // Both maps are sorted by key, walk them in step.
+        const JsonMap& mapA = *(const JsonMap*)pA;
+        const JsonMap& mapB = *(const JsonMap*)pB;
+        JsonMap::const_iterator itA = mapA.begin();
+        JsonMap::const_iterator itB = mapB.begin();
+        while (itA != mapA.end() || itB != mapB.end()) {
+            if (itB == mapB.end() || (itA != mapA.end() && itA->first < itB->first)) {
+                keys.push_back(itA->first);
+                out << "- " << Join(keys, dot) << std::endl;
+                diffCnt++;
+                itA++;
+            } else if (itA == mapA.end() || itB->first < itA->first) {
+                keys.push_back(itB->first);
+                out << "+ " << Join(keys, dot) << std::endl;
+                diffCnt++;
+                itB++;
+            } else {
+                keys.push_back(itA->first);
+                diffCnt += JsonDiff(itA->second, itB->second, keys, out);
+                itA++;
+                itB++;
+            }
+            keys.pop_back();
+        }
+    }
+    return diffCnt;
+}
+
+// ---------------------------------------------------------------------------
+// Parse two files and report differences (-diff). Return status like diff(1),
+// 0 same, 1 different, 2 unable to load or parse either file.
+static int DiffFiles(const lstring& filepathA, const lstring& filepathB, ostream& out) {
+    JsonFields fieldsA;
+    JsonFields fieldsB;
+    const lstring* filepaths[] = { &filepathA, &filepathB };
+    JsonFields* fields[] = { &fieldsA, &fieldsB };
+
+    for (int idx = 0; idx < 2; idx++) {
+        JsonBuffer buffer;
+        string error;
+        if (! LoadFile(*filepaths[idx], buffer, error)) {
+            cerr << (error.empty() ? "Unable to read" : error) << ", " << *filepaths[idx] << endl;
+            return 2;
+        }
+        try {
+            parseJson(buffer, *fields[idx]);
+        } catch (const exception& ex) {
+            cerr << ex.what() << ", Error in file:" << *filepaths[idx] << endl;
+            return 2;
+        }
+    }
+
+    JsonFields::const_iterator rootA = fieldsA.find("");
+    JsonFields::const_iterator rootB = fieldsB.find("");
+    if (rootA == fieldsA.end() && rootB == fieldsB.end())
+        return 0;   // Both empty
+    if (rootA == fieldsA.end() || rootB == fieldsB.end()) {
+        out << "~ " << dot << std::endl;
+        return 1;
+    }
+
+    StringList keys;
+    return (JsonDiff(rootA->second, rootB->second, keys, out) == 0) ? 0 : 1;
+}
+
+#ifdef HAVE_UNIX_SOCKET
+const size_t SERVE_MAX_REQUEST = 256 * 1024 * 1024;    // Largest request accepted
+const int SERVE_TIMEOUT_SEC = 30;                       // Idle read/write timeout
+
+// Send std::cerr to another stream while in scope.
+class ErrorRedirect {
+public:
+    ErrorRedirect(ostream& out) : oldBuf(std::cerr.rdbuf(out.rdbuf())) {
+    }
+    ~ErrorRedirect() {
+        std::cerr.rdbuf(oldBuf);
+    }
+private:
+    std::streambuf* oldBuf;
+};
+
+// ---------------------------------------------------------------------------
+// Process one -serve request. Payload is either a json document or a list of
+// file/directory paths (one per line) which are run thru the normal -inc/-ex filters.
+// Errors from every path are written into the reply, same text as on the command line.
+static void ServeRequest(const string& request, ostream& out) {
+    size_t first = request.find_first_not_of(" \t\r\n");
+    if (first == string::npos)
+        return;
+
+    ErrorRedirect errorToReply(out);
+    try {
+        if (request[first] == '{' || request[first] == '[') {
+            JsonBuffer buffer;
+            buffer.push(request.c_str());
+            ParseBuffer(buffer, "request", out);
+        } else {
+            std::istringstream pathStream(request);
+            string filePath;
+            StringList paths;
+            while (std::getline(pathStream, filePath)) {
+                if (! filePath.empty() && filePath.back() == '\r')
+                    filePath.pop_back();
+                if (! filePath.empty())
+                    paths.push_back(filePath);
+            }
+            InspectFiles(paths, out);
+        }
+    } catch (const exception& ex) {
+        std::cerr << ex.what() << ", Error in request" << std::endl;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Read whole request, client signals end of request by shutting down its write
+// side. Return false with error set on timeout or if request is too large.
+static bool ServeRead(int connFd, string& request, string& error) {
+    char readBuf[64 * 1024];
+    request.clear();
+    for (;;) {
+        ssize_t inCnt = read(connFd, readBuf, sizeof(readBuf));
+        if (inCnt == 0)
+            return true;
+        if (inCnt < 0) {
+            if (errno == EINTR)
+                continue;
+            error = (errno == EAGAIN || errno == EWOULDBLOCK)
+                ? "Request timed out, send request then shut down write side (EOF)"
+                : string(strerror(errno)) + ", Request read failed";
+            return false;
+        }
+        if (request.length() + inCnt > SERVE_MAX_REQUEST) {
+            error = "Request larger than " + std::to_string(SERVE_MAX_REQUEST) + " bytes";
+            return false;
+        }
+        request.append(readBuf, inCnt);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Serve requests on local unix socket until killed. Process stays warm so the
+// -inc/-ex regex patterns are compiled once.
+// Framing: one request per connection. Client writes the request and shuts down
+// its write side (EOF), reply (output and any error lines) is written back and
+// the connection closed. Connections are handled one at a time, so a client idle
+// for SERVE_TIMEOUT_SEC or sending more than SERVE_MAX_REQUEST bytes gets an
+// error reply and is dropped.
+//   Example:  nc -U -N /tmp/lljson.sock < file.json
+static int ServeSocket(const lstring& sockPath) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (sockPath.length() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path too long " << sockPath << std::endl;
+        return -1;
+    }
+    strncpy(addr.sun_path, sockPath, sizeof(addr.sun_path) - 1);
+
+    // Only replace a stale socket, never some other file at that path.
+    struct stat filestat;
+    if (lstat(sockPath, &filestat) == 0) {
+        if (! S_ISSOCK(filestat.st_mode)) {
+            std::cerr << "Path exists and is not a socket " << sockPath << std::endl;
+            return -1;
+        }
+        unlink(sockPath);
+    }
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << strerror(errno) << ", Unable to create socket" << std::endl;
+        return -1;
+    }
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || listen(listenFd, 16) != 0) {
+        std::cerr << strerror(errno) << ", Unable to listen on " << sockPath << std::endl;
+        close(listenFd);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);   // Client hanging up early must not kill the server.
+    std::cerr << "Serving on " << sockPath << std::endl;
+
+    struct timeval timeout;
+    timeout.tv_sec = SERVE_TIMEOUT_SEC;
+    timeout.tv_usec = 0;
+
+    string request;
+    for (;;) {
+        int connFd = accept(listenFd, nullptr, nullptr);
+        if (connFd < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << strerror(errno) << ", accept failed" << std::endl;
+            break;
+        }
+        setsockopt(connFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(connFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::ostringstream reply;
+        string error;
+        if (ServeRead(connFd, request, error)) {
+            ServeRequest(request, reply);
+        } else {
+            std::cerr << error << std::endl;
+            reply << error << ", Error in request" << std::endl;
+        }
+        string().swap(request);     // Release large request buffer.
+        const string& replyStr = reply.str();
+        size_t outPos = 0;
+        while (outPos < replyStr.length()) {
+            ssize_t outCnt = write(connFd, replyStr.data() + outPos, replyStr.length() - outPos);
+            if (outCnt <= 0)
+                break;
+            outPos += outCnt;
+        }
+        close(connFd);
+    }
+
+    close(listenFd);
+    unlink(sockPath);
+    return 0;
+}
+#endif
+
+#ifdef HAVE_INOTIFY
+// ---------------------------------------------------------------------------
+// Add inotify watch to directory (or file) and all its sub-directories.
+static void WatchPath(int notifyFd, const lstring& path, std::map<int, lstring>& watches) {
+    const uint32_t events = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+    int wd = inotify_add_watch(notifyFd, path, events);
+    if (wd < 0) {
+        std::cerr << strerror(errno) << ", Unable to watch " << path << std::endl;
+        return;
+    }
+    watches[wd] = path;
+
+    struct stat filestat;
+    if (stat(path, &filestat) == 0 && S_ISDIR(filestat.st_mode)) {
+        Directory_files directory(path);
+        lstring fullname;
+        while (directory.more()) {
+            directory.fullName(fullname);
+            if (directory.is_directory())
+                WatchPath(notifyFd, fullname, watches);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Process existing files, then stay resident and only process files which are
+// created or modified (-watch). Results are appended to out as they arrive.
+static int WatchFiles(const StringList& paths, ostream& out) {
+    int notifyFd = inotify_init();
+    if (notifyFd < 0) {
+        std::cerr << strerror(errno) << ", Unable to start inotify" << std::endl;
+        return -1;
+    }
+
+    std::map<int, lstring> watches;
+    for (auto const& filePath : paths) {
+        WatchPath(notifyFd, filePath, watches);   // Watch first so no change is missed.
+    }
+    std::cerr << "File Matches=" << InspectFiles(paths, out) << std::endl;
+    out.flush();
+    std::cerr << "Watching " << watches.size() << " directories" << std::endl;
+
+    alignas(struct inotify_event) char eventBuf[64 * 1024];
+    while (! watches.empty()) {
+        ssize_t inCnt = read(notifyFd, eventBuf, sizeof(eventBuf));
+        if (inCnt <= 0) {
+            if (inCnt < 0 && errno == EINTR)
+                continue;
+            std::cerr << strerror(errno) << ", inotify read failed" << std::endl;
+            break;
+        }
+
+        for (char* ptr = eventBuf; ptr < eventBuf + inCnt; ) {
+            const struct inotify_event* event = (const struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were dropped, rescan everything so no change is lost.
+                std::cerr << "inotify queue overflow, rescanning all paths" << std::endl;
+                for (auto const& filePath : paths)
+                    WatchPath(notifyFd, filePath, watches);
+                InspectFiles(paths, out);
+                out.flush();
+                continue;
+            }
+
+            auto watchIt = watches.find(event->wd);
+            if (watchIt == watches.end())
+                continue;
+            if (event->mask & IN_IGNORED) {
+                watches.erase(watchIt);
+                continue;
+            }
+
+            lstring fullname = watchIt->second;
+            if (event->len != 0) {
+                fullname += Directory_files::SLASH_CHAR;
+                fullname += event->name;
+            }
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    // Files may land before the new watch is in place, scan them now.
+                    WatchPath(notifyFd, fullname, watches);
+                    InspectFiles(StringList(1, fullname), out);
+                    out.flush();
+                }
+            } else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && FileSelected(fullname)) {
+                // IN_CREATE alone is ignored, wait until writer closes the file.
+                lstring name;
+                ParseFile(fullname, getName(name, fullname), out);
+                out.flush();
+            }
+        }
+    }
+
+    close(notifyFd);
+    return 0;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Return byte count from text with optional K, M or G suffix, ex: 512M
+static size_t getSize(const char* value) {
+    char* endPtr;
+    double size = strtod(value, &endPtr);
+    switch (toupper(*endPtr)) {
+    case 'G': size *= 1024;     // fall thru
+    case 'M': size *= 1024;     // fall thru
+    case 'K': size *= 1024;
+    }
+    return (size_t)size;
+}
+
 // ---------------------------------------------------------------------------
 // Return compiled regular expression from text.
 std::regex getRegEx(const char* value) {
@@ -503,10 +1347,27 @@ void showHelp(const char* argv0) {
             "   -includefile=<filePattern>   ; Include files by regex match \n"
             "   -excludefile=<filePattern>   ; Exclude files by regex match \n"
             "   -verbose                     ; Only dump parsed json\n"
+            "   -diff                        ; Report paths which differ between two json files\n"
+            "                                ;   exit status 0 same, 1 different, 2 error\n"
+            "   -minify                      ; Only output json with whitespace removed\n"
+            "   -pretty                      ; Only output json re-indented\n"
+            "   -instream                    ; Read json from stdin, use - as input\n"
+            "   -records                     ; Align array of objects by record, empty cell if missing\n"
+            "   -summary                     ; Output column statistics instead of rows\n"
+            "   -tape                        ; Parse into compact flat tape, no object tree\n"
+            "   -maxrows=<count>             ; Only first count rows per column, skip rest\n"
+            "   -mem-limit=<size>            ; Spill columns to temp files above size, ex 512M\n"
+            "   -readahead=<count>           ; Files loaded in background while parsing, def 4\n"
+            "   -serve=<socketPath>          ; Stay resident, serve requests on unix socket\n"
+            "   -watch                       ; After first pass, process new or changed files\n"
+            "   -watch=<outFile>             ; Same as -watch, append output to outFile\n"
             "\n"
             " Example:\n"
             "   lljson -inc=*.json -ex=foo.json -ex=bar.json dir1/subdir dir2 file1.json file2.json "
             "\n"
+            "   lljson -diff old.json new.json \n"
+            "   lljson -inc=*.json -serve=/tmp/lljson.sock \n"
+            "   nc -U -N /tmp/lljson.sock < file.json \n"
             " Example input json:\n"
             "   {\n"
             "      \"cloudCover\": [\n"
@@ -561,6 +1422,30 @@ int main(int argc, char* argv[]) {
                             excludeFilePatList.push_back(getRegEx(value));
                         }
                         break;
+                    case 'm':   // maxrows=<count> or mem-limit=<bytes>
+                        if (ValidOption("maxrows", cmd + 1, false)) {
+                            maxRows = (size_t)strtoul(value, nullptr, 10);
+                            columnMaxRows = maxRows;
+                        } else if (ValidOption("mem-limit", cmd + 1)) {
+                            columnBudget.limit = getSize(value);
+                        }
+                        break;
+                    case 'r':   // readahead=<fileCount>
+                        if (ValidOption("readahead", cmd + 1)) {
+                            readAhead = (size_t)strtoul(value, nullptr, 10);
+                        }
+                        break;
+                    case 'w':   // watch=<appendOutFile>
+                        if (ValidOption("watch", cmd + 1)) {
+                            watchMode = true;
+                            watchOutPath = value;
+                        }
+                        break;
+                    case 's':   // serve=<socketPath>
+                        if (ValidOption("serve", cmd + 1)) {
+                            servePath = value;
+                        }
+                        break;
 
                     default:
                         std::cerr << "Unknown command " << cmd << std::endl;
@@ -580,6 +1465,48 @@ int main(int argc, char* argv[]) {
                             instream = true;
                         }
                         break;
+                    case 'd':
+                        if (ValidOption("diff", cmdName)) {
+                            diffMode = true;
+                            continue;
+                        }
+                        break;
+                    case 'm':
+                        if (ValidOption("minify", cmdName)) {
+                            reformat = Minify;
+                            continue;
+                        }
+                        break;
+                    case 'p':
+                        if (ValidOption("pretty", cmdName)) {
+                            reformat = Pretty;
+                            continue;
+                        }
+                        break;
+                    case 'r':
+                        if (ValidOption("records", cmdName)) {
+                            columnRecords = true;
+                            continue;
+                        }
+                        break;
+                    case 's':
+                        if (ValidOption("summary", cmdName)) {
+                            columnSummary = true;
+                            continue;
+                        }
+                        break;
+                    case 't':
+                        if (ValidOption("tape", cmdName)) {
+                            useTape = true;
+                            continue;
+                        }
+                        break;
+                    case 'w':
+                        if (ValidOption("watch", cmdName)) {
+                            watchMode = true;
+                            continue;
+                        }
+                        break;
                     case '?':
                         showHelp(argv[0]);
                         return 0;
@@ -604,7 +1531,34 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        if (patternErrCnt == 0 && optionErrCnt == 0 && fileDirList.size() != 0) {
+        if (patternErrCnt == 0 && optionErrCnt == 0 && ! servePath.empty()) {
+#ifdef HAVE_UNIX_SOCKET
+            return ServeSocket(servePath);
+#else
+            std::cerr << "-serve requires unix sockets, not supported on this platform\n";
+            return -1;
+#endif
+        } else if (patternErrCnt == 0 && optionErrCnt == 0 && diffMode) {
+            if (fileDirList.size() != 2) {
+                std::cerr << "-diff requires two json files\n";
+                return 2;
+            }
+            return DiffFiles(fileDirList[0], fileDirList[1], cout);
+        } else if (patternErrCnt == 0 && optionErrCnt == 0 && watchMode && fileDirList.size() != 0) {
+#ifdef HAVE_INOTIFY
+            if (watchOutPath.empty())
+                return WatchFiles(fileDirList, cout);
+            ofstream watchOut(watchOutPath, std::ios::app);
+            if (! watchOut.good()) {
+                std::cerr << strerror(errno) << ", Unable to open " << watchOutPath << std::endl;
+                return -1;
+            }
+            return WatchFiles(fileDirList, watchOut);
+#else
+            std::cerr << "-watch requires inotify, not supported on this platform\n";
+            return -1;
+#endif
+        } else if (patternErrCnt == 0 && optionErrCnt == 0 && fileDirList.size() != 0) {
             if (fileDirList.size() == 1 && fileDirList[0] == "-") {
                 if (instream) {
                     JsonBuffer inJbuffer;
@@ -616,21 +1570,12 @@ int main(int argc, char* argv[]) {
                         parseJson(inJbuffer, outJfields);
                     }
 
-                    if (verbose) {
-                        JsonDump(outJfields, cout);
-                    } else {
-                        JsonTranspose(outJfields, cout);
-                    }
+                    OutputJson(outJfields, "stdin", cout);
                 } else {
-                    string filePath;
-                    while (std::getline(std::cin, filePath)) {
-                        std::cerr << "File Matches=" << InspectFiles(filePath) << std::endl;
-                    }
+                    std::cerr << "File Matches=" << InspectStream(std::cin, cout) << std::endl;
                 }
             } else {
-                for (auto const& filePath : fileDirList) {
-                    std::cerr << "File Matches=" << InspectFiles(filePath) << std::endl;
-                }
+                std::cerr << "File Matches=" << InspectFiles(fileDirList, cout) << std::endl;
             }
         }
 